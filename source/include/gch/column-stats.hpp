@@ -0,0 +1,583 @@
+/** column-stats.hpp
+ * Single-pass, mergeable statistics over a selected tuple column.
+ *
+ * Copyright © 2020 Gene Harvey
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef GCH_COLUMN_STATS_HPP
+#define GCH_COLUMN_STATS_HPP
+
+#include "gch/select-iterator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace gch
+{
+
+  namespace detail
+  {
+
+    // splitmix64 finalizer. std::hash is the identity for integers on most
+    // implementations, which would leave the high bits empty.
+    inline std::uint64_t finalize_hash (std::uint64_t x) noexcept
+    {
+      x += 0x9E3779B97F4A7C15ULL;
+      x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+      return x ^ (x >> 31);
+    }
+
+    // Precondition: x != 0.
+    inline unsigned count_leading_zeros (std::uint64_t x) noexcept
+    {
+#if defined (__GNUC__) || defined (__clang__)
+      return static_cast<unsigned> (__builtin_clzll (x));
+#else
+      unsigned n = 0;
+      for (std::uint64_t bit = std::uint64_t (1) << 63; ! (x & bit); bit >>= 1)
+        ++n;
+      return n;
+#endif
+    }
+
+  }
+
+  /**
+   * HyperLogLog distinct-count estimator with 2^Precision one-byte registers.
+   * Two estimators with the same parameters may be merged.
+   */
+  template <typename T, std::size_t Precision = 12, typename Hash = std::hash<T>>
+  class hyperloglog
+  {
+    static_assert (4 <= Precision && Precision <= 18, "precision out of range");
+
+  public:
+    using value_type = T;
+    using hasher     = Hash;
+
+    static constexpr std::size_t num_registers = std::size_t (1) << Precision;
+
+    hyperloglog            (void)                   = default;
+    hyperloglog            (const hyperloglog&)     = default;
+    hyperloglog            (hyperloglog&&) noexcept = default;
+    hyperloglog& operator= (const hyperloglog&)     = default;
+    hyperloglog& operator= (hyperloglog&&) noexcept = default;
+    ~hyperloglog           (void)                   = default;
+
+    explicit hyperloglog (const Hash& hash)
+      : m_hash (hash)
+    { }
+
+    void push (const value_type& val)
+    {
+      const std::uint64_t h = detail::finalize_hash (static_cast<std::uint64_t> (m_hash (val)));
+      const std::size_t   idx = static_cast<std::size_t> (h >> (64 - Precision));
+
+      // Guard bit bounds the rank at 64 - Precision + 1.
+      const std::uint64_t w = (h << Precision) | (std::uint64_t (1) << (Precision - 1));
+      const unsigned char rank = static_cast<unsigned char> (detail::count_leading_zeros (w) + 1);
+
+      if (m_registers[idx] < rank)
+        m_registers[idx] = rank;
+    }
+
+    hyperloglog& merge (const hyperloglog& other)
+    {
+      for (std::size_t i = 0; i < num_registers; ++i)
+      {
+        if (m_registers[i] < other.m_registers[i])
+          m_registers[i] = other.m_registers[i];
+      }
+      return *this;
+    }
+
+    GCH_NODISCARD
+    double estimate (void) const
+    {
+      const double m = static_cast<double> (num_registers);
+      double sum = 0.0;
+      std::size_t zeros = 0;
+      for (unsigned char r : m_registers)
+      {
+        sum += std::ldexp (1.0, -static_cast<int> (r));
+        if (r == 0)
+          ++zeros;
+      }
+
+      const double alpha = 0.7213 / (1.0 + 1.079 / m);
+      const double raw = alpha * m * m / sum;
+
+      // Small-range correction by linear counting.
+      if (raw <= 2.5 * m && zeros != 0)
+        return m * std::log (m / static_cast<double> (zeros));
+      return raw;
+    }
+
+  private:
+    std::vector<unsigned char> m_registers = std::vector<unsigned char> (num_registers, 0);
+    Hash m_hash;
+  };
+
+  template <typename T, std::size_t Precision, typename Hash>
+  constexpr std::size_t hyperloglog<T, Precision, Hash>::num_registers;
+
+  /**
+   * KLL quantile sketch. Retains O(k log(n/k)) samples in a stack of
+   * compactors; each compaction sorts a level and promotes every other
+   * element, doubling its weight. Two sketches may be merged.
+   *
+   * Once the bottom compactors would be narrower than min_width they are
+   * replaced by a sampler which keeps one random element out of each block
+   * of 2^b, so only about n / 2^b elements are ever sorted. Until then
+   * every element is sorted once per level it reaches.
+   */
+  template <typename T, typename Compare = std::less<T>>
+  class kll_sketch
+  {
+  public:
+    using value_type  = T;
+    using size_type   = std::size_t;
+    using key_compare = Compare;
+
+    static constexpr size_type default_k = 200;
+
+    kll_sketch            (void)                  = default;
+    kll_sketch            (const kll_sketch&)     = default;
+    kll_sketch            (kll_sketch&&)          = default;
+    kll_sketch& operator= (const kll_sketch&)     = default;
+    kll_sketch& operator= (kll_sketch&&)          = default;
+    ~kll_sketch           (void)                  = default;
+
+    explicit kll_sketch (size_type k, const Compare& comp = Compare ())
+      : m_k (std::max (k, size_type (8))),
+        m_comp (comp)
+    { }
+
+    void push (const value_type& val)
+    {
+      if (m_levels.empty ())
+        grow ();
+
+      ++m_count;
+
+      // The element at a uniformly random position in each block stands in
+      // for the whole block. It is kept as soon as it arrives, so the
+      // retained weight is an unbiased count even mid-block.
+      const bool take = (m_block == m_pick);
+      if (++m_block == (size_type (1) << m_sample_level))
+        start_block ();
+
+      if (take)
+      {
+        m_levels[m_sample_level].push_back (val);
+        if (++m_retained >= m_capacity)
+          compress ();
+      }
+    }
+
+    kll_sketch& merge (const kll_sketch& other)
+    {
+      if (other.m_count == 0)
+        return *this;
+
+      // Appending a level to itself would insert a vector's own range.
+      if (&other == this)
+        return merge (kll_sketch (other));
+
+      while (m_levels.size () < other.m_levels.size ())
+        grow ();
+
+      for (size_type h = 0; h < other.m_levels.size (); ++h)
+      {
+        m_levels[h].insert (m_levels[h].end (),
+                            other.m_levels[h].begin (), other.m_levels[h].end ());
+      }
+      m_count    += other.m_count;
+      m_retained += other.m_retained;
+
+      while (m_retained >= m_capacity)
+        compress ();
+      return *this;
+    }
+
+    GCH_NODISCARD
+    size_type count (void) const noexcept
+    {
+      return m_count;
+    }
+
+    GCH_NODISCARD
+    size_type retained (void) const noexcept
+    {
+      return m_retained;
+    }
+
+    /**
+     * Returns the approximate q-quantile for q in [0, 1].
+     * Precondition: count () > 0.
+     */
+    GCH_NODISCARD
+    value_type quantile (double q) const
+    {
+      std::vector<std::pair<value_type, std::uint64_t>> weighted;
+      weighted.reserve (m_retained);
+      for (size_type h = 0; h < m_levels.size (); ++h)
+      {
+        for (const value_type& v : m_levels[h])
+          weighted.emplace_back (v, std::uint64_t (1) << h);
+      }
+
+      const Compare& comp = m_comp;
+      std::sort (weighted.begin (), weighted.end (),
+                 [&comp](const std::pair<value_type, std::uint64_t>& lhs,
+                         const std::pair<value_type, std::uint64_t>& rhs)
+                 {
+                   return comp (lhs.first, rhs.first);
+                 });
+
+      std::uint64_t total = 0;
+      for (const auto& p : weighted)
+        total += p.second;
+
+      q = std::min (std::max (q, 0.0), 1.0);
+      const double target = q * static_cast<double> (total);
+
+      std::uint64_t cumulative = 0;
+      for (const auto& p : weighted)
+      {
+        cumulative += p.second;
+        if (static_cast<double> (cumulative) >= target)
+          return p.first;
+      }
+      return weighted.back ().first;
+    }
+
+  private:
+    // Levels narrower than this are compacted so often that the per-call
+    // overhead dominates; it costs at most min_width samples per level.
+    static constexpr size_type min_width = 8;
+
+    void grow (void)
+    {
+      m_levels.emplace_back ();
+
+      // Capacities shrink geometrically with depth below the top level, so
+      // they all shift whenever a level is added.
+      m_level_capacity.resize (m_levels.size ());
+      m_capacity = 0;
+      size_type sample_level = 0;
+      double cap = static_cast<double> (m_k);
+      for (size_type h = m_levels.size (); h-- > 0; cap *= 2.0 / 3.0)
+      {
+        if (cap < static_cast<double> (min_width) && sample_level == 0)
+          sample_level = h;
+        m_level_capacity[h] = std::max (static_cast<size_type> (std::ceil (cap)), min_width);
+        m_capacity += m_level_capacity[h];
+      }
+
+      if (m_sample_level < sample_level)
+      {
+        m_sample_level = sample_level;
+        start_block ();
+      }
+    }
+
+    void start_block (void) noexcept
+    {
+      m_block = 0;
+      m_pick  = static_cast<size_type> (next_random ()
+                                        & ((std::uint64_t (1) << m_sample_level) - 1));
+    }
+
+    // Compacts every level at capacity in one sweep, bottom up, so that
+    // promotions cascade and a single call frees at least half of level 0.
+    void compress (void)
+    {
+      for (size_type h = 0; h < m_levels.size (); ++h)
+      {
+        if (m_levels[h].size () < m_level_capacity[h])
+          continue;
+
+        if (h + 1 == m_levels.size ())
+          grow ();
+
+        std::vector<value_type>& level = m_levels[h];
+        std::vector<value_type>& next  = m_levels[h + 1];
+        std::sort (level.begin (), level.end (), m_comp);
+
+        // An odd element out stays behind at this level.
+        const size_type first = level.size () % 2;
+        size_type       i     = first + (next_bit () ? 1 : 0);
+        for (; i < level.size (); i += 2)
+          next.push_back (std::move (level[i]));
+
+        const size_type promoted = (level.size () - first) / 2;
+        level.erase (level.begin () + static_cast<std::ptrdiff_t> (first), level.end ());
+        m_retained -= promoted;
+      }
+    }
+
+    std::uint64_t next_random (void) noexcept
+    {
+      // xorshift64; compaction and sampling only need unbiased bits.
+      m_rng ^= m_rng << 13;
+      m_rng ^= m_rng >> 7;
+      m_rng ^= m_rng << 17;
+      return m_rng;
+    }
+
+    bool next_bit (void) noexcept
+    {
+      return (next_random () >> 63) != 0;
+    }
+
+    std::vector<std::vector<value_type>> m_levels;
+    std::vector<size_type>               m_level_capacity;
+    size_type     m_k            = default_k;
+    size_type     m_count        = 0;
+    size_type     m_retained     = 0;
+    size_type     m_capacity     = 0;
+    size_type     m_sample_level = 0;
+    size_type     m_block        = 0;
+    size_type     m_pick         = 0;
+    std::uint64_t m_rng          = 0x2545F4914F6CDD1DULL;
+    Compare       m_comp;
+  };
+
+  template <typename T, typename Compare>
+  constexpr typename kll_sketch<T, Compare>::size_type kll_sketch<T, Compare>::default_k;
+
+  template <typename T, typename Compare>
+  constexpr typename kll_sketch<T, Compare>::size_type kll_sketch<T, Compare>::min_width;
+
+  /**
+   * Count, min/max, distinct estimate, and quantile sketch of a column,
+   * accumulated in one pass. Partial results over disjoint chunks may be
+   * computed independently (e.g. one per thread) and combined with merge.
+   */
+  template <typename T, typename Compare = std::less<T>, typename Hash = std::hash<T>>
+  class column_statistics
+  {
+  public:
+    using value_type  = T;
+    using size_type   = std::size_t;
+    using key_compare = Compare;
+    using hasher      = Hash;
+
+    using distinct_sketch = hyperloglog<T, 12, Hash>;
+    using quantile_sketch = kll_sketch<T, Compare>;
+
+    column_statistics            (void)                         = default;
+    column_statistics            (const column_statistics&)     = default;
+    column_statistics            (column_statistics&&)          = default;
+    column_statistics& operator= (const column_statistics&)     = default;
+    column_statistics& operator= (column_statistics&&)          = default;
+    ~column_statistics           (void)                         = default;
+
+    explicit column_statistics (size_type k, const Compare& comp = Compare (),
+                                const Hash& hash = Hash ())
+      : m_distinct (hash),
+        m_quantiles (k, comp),
+        m_comp (comp)
+    { }
+
+    void push (const value_type& val)
+    {
+      if (m_count == 0)
+      {
+        m_min = val;
+        m_max = val;
+      }
+      else if (m_comp (val, m_min))
+        m_min = val;
+      else if (m_comp (m_max, val))
+        m_max = val;
+
+      ++m_count;
+      m_distinct.push (val);
+      m_quantiles.push (val);
+    }
+
+    column_statistics& merge (const column_statistics& other)
+    {
+      if (other.m_count == 0)
+        return *this;
+
+      if (m_count == 0)
+      {
+        m_min = other.m_min;
+        m_max = other.m_max;
+      }
+      else
+      {
+        if (m_comp (other.m_min, m_min))
+          m_min = other.m_min;
+        if (m_comp (m_max, other.m_max))
+          m_max = other.m_max;
+      }
+
+      m_count += other.m_count;
+      m_distinct.merge (other.m_distinct);
+      m_quantiles.merge (other.m_quantiles);
+      return *this;
+    }
+
+    GCH_NODISCARD
+    size_type count (void) const noexcept
+    {
+      return m_count;
+    }
+
+    GCH_NODISCARD
+    bool empty (void) const noexcept
+    {
+      return m_count == 0;
+    }
+
+    /** Precondition: ! empty (). */
+    GCH_NODISCARD
+    const value_type& min (void) const noexcept
+    {
+      return m_min;
+    }
+
+    /** Precondition: ! empty (). */
+    GCH_NODISCARD
+    const value_type& max (void) const noexcept
+    {
+      return m_max;
+    }
+
+    GCH_NODISCARD
+    double distinct_estimate (void) const
+    {
+      return m_distinct.estimate ();
+    }
+
+    /**
+     * Approximate q-quantile; the endpoints are exact.
+     * Precondition: ! empty ().
+     */
+    GCH_NODISCARD
+    value_type quantile (double q) const
+    {
+      if (q <= 0.0)
+        return m_min;
+      if (q >= 1.0)
+        return m_max;
+      return m_quantiles.quantile (q);
+    }
+
+    GCH_NODISCARD
+    const distinct_sketch& distinct (void) const noexcept
+    {
+      return m_distinct;
+    }
+
+    GCH_NODISCARD
+    const quantile_sketch& quantiles (void) const noexcept
+    {
+      return m_quantiles;
+    }
+
+  private:
+    size_type       m_count = 0;
+    value_type      m_min { };
+    value_type      m_max { };
+    distinct_sketch m_distinct;
+    quantile_sketch m_quantiles;
+    Compare         m_comp;
+  };
+
+  /**
+   * Pushes column Index of [first, last) into stats, which may already hold a
+   * partial result. Use this to build per-chunk states with the same sketch
+   * size, comparator, and hasher as the state they will be merged into.
+   */
+  template <std::size_t Index, typename TupleIter,
+            typename T, typename Compare, typename Hash>
+  column_statistics<T, Compare, Hash>&
+  column_stats (TupleIter first, TupleIter last, column_statistics<T, Compare, Hash>& stats)
+  {
+    using element_type = typename std::remove_cv<typename std::remove_reference<
+      typename std::tuple_element<Index,
+                                  typename std::iterator_traits<TupleIter>::value_type>::type
+      >::type>::type;
+
+    static_assert (std::is_same<element_type, T>::value,
+                   "column type does not match the statistics value type");
+
+    for (auto it = make_select_iterator<Index> (std::move (first)); it != last; ++it)
+      stats.push (*it);
+    return stats;
+  }
+
+  template <std::size_t Index, typename TupleIter,
+            typename Value = typename std::tuple_element<
+              Index, typename std::iterator_traits<TupleIter>::value_type>::type,
+            typename Compare = std::less<Value>, typename Hash = std::hash<Value>>
+  column_statistics<Value, Compare, Hash>
+  column_stats (TupleIter first, TupleIter last, std::size_t k,
+                const Compare& comp = Compare (), const Hash& hash = Hash ())
+  {
+    column_statistics<Value, Compare, Hash> ret (k, comp, hash);
+    column_stats<Index> (std::move (first), std::move (last), ret);
+    return ret;
+  }
+
+  template <std::size_t Index, typename TupleIter>
+  column_statistics<
+    typename std::tuple_element<Index,
+                                typename std::iterator_traits<TupleIter>::value_type>::type>
+  column_stats (TupleIter first, TupleIter last)
+  {
+    using value_type =
+      typename std::tuple_element<Index,
+                                  typename std::iterator_traits<TupleIter>::value_type>::type;
+
+    column_statistics<value_type> ret;
+    column_stats<Index> (std::move (first), std::move (last), ret);
+    return ret;
+  }
+
+  template <typename T, typename TupleIter, typename Compare, typename Hash>
+  column_statistics<T, Compare, Hash>&
+  column_stats (TupleIter first, TupleIter last, column_statistics<T, Compare, Hash>& stats)
+  {
+    return column_stats<tuple_index<T, typename std::iterator_traits<TupleIter>::value_type>::value>
+             (std::move (first), std::move (last), stats);
+  }
+
+  template <typename T, typename TupleIter,
+            typename Compare = std::less<T>, typename Hash = std::hash<T>>
+  column_statistics<T, Compare, Hash>
+  column_stats (TupleIter first, TupleIter last, std::size_t k,
+                const Compare& comp = Compare (), const Hash& hash = Hash ())
+  {
+    column_statistics<T, Compare, Hash> ret (k, comp, hash);
+    column_stats<T> (std::move (first), std::move (last), ret);
+    return ret;
+  }
+
+  template <typename T, typename TupleIter>
+  column_statistics<T>
+  column_stats (TupleIter first, TupleIter last)
+  {
+    return column_stats<tuple_index<T, typename std::iterator_traits<TupleIter>::value_type>::value>
+             (std::move (first), std::move (last));
+  }
+
+}
+
+#endif // GCH_COLUMN_STATS_HPP
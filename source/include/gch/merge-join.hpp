@@ -0,0 +1,361 @@
+/** merge-join.hpp
+ * Joins and set operations on tuple ranges sorted by a selected key.
+ *
+ * Copyright © 2020 Gene Harvey
+ *
+ * This software may be modified and distributed under the terms
+ * of the MIT license. See the LICENSE file for details.
+ * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+#ifndef GCH_MERGE_JOIN_HPP
+#define GCH_MERGE_JOIN_HPP
+
+#include "gch/select-iterator.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+
+namespace gch
+{
+
+  namespace detail
+  {
+
+    struct key_less
+    {
+      template <typename L, typename R>
+      constexpr auto operator() (const L& lhs, const R& rhs) const
+        noexcept (noexcept (lhs < rhs))
+        -> decltype (lhs < rhs)
+      {
+        return lhs < rhs;
+      }
+    };
+
+    template <typename Key, typename Compare>
+    struct before_key
+    {
+      template <typename E>
+      bool operator() (const E& e) const
+      {
+        return comp (e, key);
+      }
+
+      const Key& key;
+      Compare&   comp;
+    };
+
+    template <typename Key, typename Compare>
+    struct not_after_key
+    {
+      template <typename E>
+      bool operator() (const E& e) const
+      {
+        return ! comp (key, e);
+      }
+
+      const Key& key;
+      Compare&   comp;
+    };
+
+    template <typename Iter, typename Pred>
+    Iter gallop (Iter first, Iter last, Pred pred, std::forward_iterator_tag)
+    {
+      while (first != last && pred (*first))
+        ++first;
+      return first;
+    }
+
+    // Exponential search for the first element not satisfying pred. Skipping
+    // d elements costs about 2 log2 (d) + 1 comparisons, which beats stepping
+    // only on long runs, so it is reached through skip_lower below.
+    template <typename Iter, typename Pred>
+    Iter gallop (Iter first, Iter last, Pred pred, std::random_access_iterator_tag)
+    {
+      using difference_type = typename std::iterator_traits<Iter>::difference_type;
+
+      if (first == last || ! pred (*first))
+        return first;
+
+      const difference_type n = last - first;
+      difference_type lo    = 0;
+      difference_type bound = 1;
+      while (bound < n && pred (first[bound]))
+      {
+        lo = bound;
+        bound *= 2;
+      }
+      return std::partition_point (first + (lo + 1), first + std::min (bound, n), pred);
+    }
+
+    // Kept out of line so the stepping loop in the callers stays compact.
+    template <typename Iter, typename Key, typename Compare>
+    GCH_NOINLINE
+    Iter gallop_lower (Iter first, Iter last, const Key& key, Compare& comp)
+    {
+      return gallop (first, last, before_key<Key, Compare> { key, comp },
+                     typename std::iterator_traits<Iter>::iterator_category ());
+    }
+
+    // Returns the end of the run of elements equivalent to key, where *first
+    // is already known to be equivalent.
+    template <typename Iter, typename Key, typename Compare>
+    Iter equal_run_end (Iter first, Iter last, const Key& key, Compare& comp)
+    {
+      return gallop (std::next (first), last, not_after_key<Key, Compare> { key, comp },
+                     typename std::iterator_traits<Iter>::iterator_category ());
+    }
+
+    // Consecutive wins by one side before the merge switches from stepping to
+    // exponential search, as in timsort.
+    constexpr std::size_t min_gallop = 7;
+
+    // Advances it past an element the caller already found to precede key.
+    // Steps linearly, so interleaved inputs cost the same comparisons as an
+    // ordinary merge; once run reaches min_gallop the rest of the run is
+    // skipped by exponential search.
+    template <typename Iter, typename Key, typename Compare>
+    Iter skip_lower (Iter it, Iter last, const Key& key, Compare& comp, std::size_t& run)
+    {
+      ++it;
+      if (++run < min_gallop)
+        return it;
+
+      run = 0;
+      return gallop_lower (it, last, key, comp);
+    }
+
+  }
+
+  /**
+   * Inner join of two ranges sorted by columns LeftIndex and RightIndex.
+   * Calls sink (left_it, right_it) with the underlying row iterators for every
+   * pair of rows with equivalent keys, in order. The merge steps linearly and
+   * switches to exponential search on random access ranges once one side
+   * wins min_gallop times in a row, so long runs of non-matching keys cost
+   * O(log d) comparisons.
+   */
+  template <std::size_t LeftIndex, std::size_t RightIndex,
+            typename LeftIter, typename RightIter, typename Sink,
+            typename Compare = detail::key_less>
+  Sink merge_join (LeftIter first1, LeftIter last1, RightIter first2, RightIter last2,
+                   Sink sink, Compare comp = Compare ())
+  {
+    auto l  = make_select_iterator<LeftIndex> (std::move (first1));
+    auto le = make_select_iterator<LeftIndex> (std::move (last1));
+    auto r  = make_select_iterator<RightIndex> (std::move (first2));
+    auto re = make_select_iterator<RightIndex> (std::move (last2));
+
+    std::size_t l_run = 0;
+    std::size_t r_run = 0;
+    while (l != le && r != re)
+    {
+      if (comp (*l, *r))
+      {
+        l = detail::skip_lower (l, le, *r, comp, l_run);
+        r_run = 0;
+      }
+      else if (comp (*r, *l))
+      {
+        r = detail::skip_lower (r, re, *l, comp, r_run);
+        l_run = 0;
+      }
+      else
+      {
+        const auto l_end = detail::equal_run_end (l, le, *r, comp);
+        const auto r_end = detail::equal_run_end (r, re, *l, comp);
+        l_run = r_run = 0;
+        for (; l != l_end; ++l)
+        {
+          for (auto it = r; it != r_end; ++it)
+            sink (l.base (), it.base ());
+        }
+        r = r_end;
+      }
+    }
+    return sink;
+  }
+
+  /**
+   * Calls sink (left_it) for every row of the left range whose key has an
+   * equivalent in the right range.
+   */
+  template <std::size_t LeftIndex, std::size_t RightIndex,
+            typename LeftIter, typename RightIter, typename Sink,
+            typename Compare = detail::key_less>
+  Sink semi_join (LeftIter first1, LeftIter last1, RightIter first2, RightIter last2,
+                  Sink sink, Compare comp = Compare ())
+  {
+    auto l  = make_select_iterator<LeftIndex> (std::move (first1));
+    auto le = make_select_iterator<LeftIndex> (std::move (last1));
+    auto r  = make_select_iterator<RightIndex> (std::move (first2));
+    auto re = make_select_iterator<RightIndex> (std::move (last2));
+
+    std::size_t l_run = 0;
+    std::size_t r_run = 0;
+    while (l != le && r != re)
+    {
+      if (comp (*l, *r))
+      {
+        l = detail::skip_lower (l, le, *r, comp, l_run);
+        r_run = 0;
+      }
+      else if (comp (*r, *l))
+      {
+        r = detail::skip_lower (r, re, *l, comp, r_run);
+        l_run = 0;
+      }
+      else
+      {
+        const auto r_end = detail::equal_run_end (r, re, *l, comp);
+        l_run = r_run = 0;
+        for (; l != le && ! comp (*r, *l); ++l)
+          sink (l.base ());
+        r = r_end;
+      }
+    }
+    return sink;
+  }
+
+  /**
+   * Calls sink (left_it) for every row of the left range whose key has no
+   * equivalent in the right range (the set difference by key).
+   */
+  template <std::size_t LeftIndex, std::size_t RightIndex,
+            typename LeftIter, typename RightIter, typename Sink,
+            typename Compare = detail::key_less>
+  Sink anti_join (LeftIter first1, LeftIter last1, RightIter first2, RightIter last2,
+                  Sink sink, Compare comp = Compare ())
+  {
+    auto l  = make_select_iterator<LeftIndex> (std::move (first1));
+    auto le = make_select_iterator<LeftIndex> (std::move (last1));
+    auto r  = make_select_iterator<RightIndex> (std::move (first2));
+    auto re = make_select_iterator<RightIndex> (std::move (last2));
+
+    // Every left row is visited to be emitted, so only the right side skips.
+    std::size_t r_run = 0;
+    while (l != le && r != re)
+    {
+      if (comp (*l, *r))
+      {
+        sink (l.base ());
+        ++l;
+        r_run = 0;
+      }
+      else if (comp (*r, *l))
+        r = detail::skip_lower (r, re, *l, comp, r_run);
+      else
+      {
+        const auto l_end = detail::equal_run_end (l, le, *r, comp);
+        r = detail::equal_run_end (r, re, *l, comp);
+        l = l_end;
+        r_run = 0;
+      }
+    }
+
+    for (; l != le; ++l)
+      sink (l.base ());
+    return sink;
+  }
+
+  /**
+   * Calls left_sink (left_it) for every left row without a match and
+   * right_sink (right_it) for every right row without a match, in key order
+   * (the symmetric difference by key).
+   */
+  template <std::size_t LeftIndex, std::size_t RightIndex,
+            typename LeftIter, typename RightIter, typename LeftSink, typename RightSink,
+            typename Compare = detail::key_less>
+  std::pair<LeftSink, RightSink>
+  symmetric_anti_join (LeftIter first1, LeftIter last1, RightIter first2, RightIter last2,
+                       LeftSink left_sink, RightSink right_sink, Compare comp = Compare ())
+  {
+    auto l  = make_select_iterator<LeftIndex> (std::move (first1));
+    auto le = make_select_iterator<LeftIndex> (std::move (last1));
+    auto r  = make_select_iterator<RightIndex> (std::move (first2));
+    auto re = make_select_iterator<RightIndex> (std::move (last2));
+
+    while (l != le && r != re)
+    {
+      if (comp (*l, *r))
+      {
+        left_sink (l.base ());
+        ++l;
+      }
+      else if (comp (*r, *l))
+      {
+        right_sink (r.base ());
+        ++r;
+      }
+      else
+      {
+        const auto l_end = detail::equal_run_end (l, le, *r, comp);
+        r = detail::equal_run_end (r, re, *l, comp);
+        l = l_end;
+      }
+    }
+
+    for (; l != le; ++l)
+      left_sink (l.base ());
+    for (; r != re; ++r)
+      right_sink (r.base ());
+    return { std::move (left_sink), std::move (right_sink) };
+  }
+
+  template <std::size_t LeftIndex, std::size_t RightIndex,
+            typename LeftRange, typename RightRange, typename Sink,
+            typename Compare = detail::key_less>
+  Sink merge_join (LeftRange& left, RightRange& right, Sink sink, Compare comp = Compare ())
+  {
+    using std::begin;
+    using std::end;
+    return merge_join<LeftIndex, RightIndex> (begin (left), end (left),
+                                              begin (right), end (right),
+                                              std::move (sink), std::move (comp));
+  }
+
+  template <std::size_t LeftIndex, std::size_t RightIndex,
+            typename LeftRange, typename RightRange, typename Sink,
+            typename Compare = detail::key_less>
+  Sink semi_join (LeftRange& left, RightRange& right, Sink sink, Compare comp = Compare ())
+  {
+    using std::begin;
+    using std::end;
+    return semi_join<LeftIndex, RightIndex> (begin (left), end (left),
+                                             begin (right), end (right),
+                                             std::move (sink), std::move (comp));
+  }
+
+  template <std::size_t LeftIndex, std::size_t RightIndex,
+            typename LeftRange, typename RightRange, typename Sink,
+            typename Compare = detail::key_less>
+  Sink anti_join (LeftRange& left, RightRange& right, Sink sink, Compare comp = Compare ())
+  {
+    using std::begin;
+    using std::end;
+    return anti_join<LeftIndex, RightIndex> (begin (left), end (left),
+                                             begin (right), end (right),
+                                             std::move (sink), std::move (comp));
+  }
+
+  template <std::size_t LeftIndex, std::size_t RightIndex,
+            typename LeftRange, typename RightRange, typename LeftSink, typename RightSink,
+            typename Compare = detail::key_less>
+  std::pair<LeftSink, RightSink>
+  symmetric_anti_join (LeftRange& left, RightRange& right,
+                       LeftSink left_sink, RightSink right_sink, Compare comp = Compare ())
+  {
+    using std::begin;
+    using std::end;
+    return symmetric_anti_join<LeftIndex, RightIndex> (begin (left), end (left),
+                                                       begin (right), end (right),
+                                                       std::move (left_sink),
+                                                       std::move (right_sink),
+                                                       std::move (comp));
+  }
+
+}
+
+#endif // GCH_MERGE_JOIN_HPP
@@ -38,6 +38,16 @@
 #  endif
 #endif
 
+#ifndef GCH_NOINLINE
+#  if defined (_MSC_VER)
+#    define GCH_NOINLINE __declspec (noinline)
+#  elif defined (__GNUC__) || defined (__clang__)
+#    define GCH_NOINLINE __attribute__ ((noinline))
+#  else
+#    define GCH_NOINLINE
+#  endif
+#endif
+
 #if defined (__cpp_impl_three_way_comparison) && __cpp_impl_three_way_comparison >= 201907L
 #  ifndef GCH_IMPL_THREE_WAY_COMPARISON
 #    define GCH_IMPL_THREE_WAY_COMPARISON
@@ -0,0 +1,129 @@
+#ifdef _ITERATOR_DEBUG_LEVEL
+#undef _ITERATOR_DEBUG_LEVEL
+#endif
+#define _ITERATOR_DEBUG_LEVEL 0
+
+#include "gch/column-stats.hpp"
+#include <tuple>
+#include <vector>
+#include <string>
+#include <cassert>
+#include <cmath>
+
+using namespace gch;
+
+struct point
+{
+  int x;
+  int y;
+};
+
+struct point_less
+{
+  bool operator() (const point& lhs, const point& rhs) const
+  {
+    return lhs.x < rhs.x || (lhs.x == rhs.x && lhs.y < rhs.y);
+  }
+};
+
+struct point_hash
+{
+  std::size_t operator() (const point& p) const
+  {
+    return static_cast<std::size_t> (p.x) * 31U + static_cast<std::size_t> (p.y);
+  }
+};
+
+int main()
+{
+  using row = std::tuple<long, std::string, double>;
+  std::vector<row> v;
+  for (long i = 0; i < 100000; ++i)
+    v.emplace_back ((i * 7919) % 100000, std::to_string (i % 1000), static_cast<double> (i));
+
+  auto s0 = column_stats<0> (v.begin (), v.end ());
+  assert (s0.count () == 100000);
+  assert (s0.min () == 0);
+  assert (s0.max () == 99999);
+  assert (std::abs (s0.distinct_estimate () - 100000.0) < 5000.0);
+  assert (std::abs (static_cast<double> (s0.quantile (0.5)) - 50000.0) < 2000.0);
+  assert (std::abs (static_cast<double> (s0.quantile (0.9)) - 90000.0) < 2000.0);
+  assert (s0.quantiles ().retained () < 2000);
+
+  auto s1 = column_stats<std::string> (v.cbegin (), v.cend ());
+  assert (s1.count () == 100000);
+  assert (s1.min () == "0");
+  assert (s1.max () == "999");
+  assert (std::abs (s1.distinct_estimate () - 1000.0) < 50.0);
+
+  // Chunked partial states merge to the same summary.
+  auto mid = v.begin () + 37000;
+  auto lhs = column_stats<double> (v.begin (), mid);
+  auto rhs = column_stats<double> (mid, v.end ());
+  assert (lhs.max () == 36999.0);
+  assert (rhs.min () == 37000.0);
+
+  column_statistics<double> merged;
+  merged.merge (lhs).merge (rhs);
+  assert (merged.count () == 100000);
+  assert (merged.min () == 0.0);
+  assert (merged.max () == 99999.0);
+  assert (std::abs (merged.distinct_estimate () - 100000.0) < 5000.0);
+  assert (std::abs (merged.quantile (0.25) - 25000.0) < 2000.0);
+  assert (merged.quantile (0.0) == 0.0);
+  assert (merged.quantile (1.0) == 99999.0);
+
+  // Merging a state into itself counts every row twice.
+  merged.merge (merged);
+  assert (merged.count () == 200000);
+  assert (merged.quantiles ().count () == 200000);
+  assert (std::abs (merged.quantile (0.25) - 25000.0) < 2000.0);
+
+  // A single streaming pass keeps bounded state and stays within 1% rank
+  // error, including on presorted input.
+  const std::size_t n = 1000000;
+  for (int order = 0; order < 3; ++order)
+  {
+    kll_sketch<long> sketch;
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      const std::size_t j = order == 0 ? i : (order == 1 ? n - 1 - i : (i * 2654435761U) % n);
+      sketch.push (static_cast<long> (j));
+    }
+    assert (sketch.count () == n);
+    assert (sketch.retained () < 1000);
+    for (int d = 1; d < 10; ++d)
+    {
+      const double expected = static_cast<double> (n) * d / 10.0;
+      assert (std::abs (static_cast<double> (sketch.quantile (d / 10.0)) - expected) < n / 100.0);
+    }
+  }
+
+  // Partial states built with a caller-chosen configuration merge into a
+  // state with the same configuration.
+  column_statistics<long> configured (64);
+  column_stats<0> (v.begin (), mid, configured);
+  configured.merge (column_stats<0> (mid, v.end (), 64));
+  assert (configured.count () == 100000);
+  assert (configured.min () == 0);
+  assert (configured.max () == 99999);
+  assert (configured.quantiles ().retained () < s0.quantiles ().retained ());
+
+  // Columns without std::hash or operator< work given a comparator and hasher.
+  std::vector<std::tuple<int, point>> pts;
+  for (int i = 0; i < 1000; ++i)
+    pts.emplace_back (i, point { i % 10, i % 7 });
+
+  auto sp = column_stats<point> (pts.begin (), pts.end (), 100, point_less { }, point_hash { });
+  assert (sp.count () == 1000);
+  assert (sp.min ().x == 0 && sp.min ().y == 0);
+  assert (sp.max ().x == 9 && sp.max ().y == 6);
+  assert (std::abs (sp.distinct_estimate () - 70.0) < 5.0);
+
+  std::vector<row> empty;
+  auto se = column_stats<0> (empty.begin (), empty.end ());
+  assert (se.empty ());
+  assert (se.distinct_estimate () == 0.0);
+
+  return 0;
+}
@@ -0,0 +1,146 @@
+#ifdef _ITERATOR_DEBUG_LEVEL
+#undef _ITERATOR_DEBUG_LEVEL
+#endif
+#define _ITERATOR_DEBUG_LEVEL 0
+
+#include "gch/merge-join.hpp"
+#include <tuple>
+#include <vector>
+#include <list>
+#include <string>
+#include <utility>
+#include <cassert>
+#include <memory>
+
+using namespace gch;
+
+using event = std::tuple<int, std::string>;
+using tag   = std::pair<std::string, int>;
+using event_iter = std::vector<event>::const_iterator;
+using tag_iter   = std::vector<tag>::const_iterator;
+
+struct pair_sink
+{
+  void operator() (event_iter l, tag_iter r)
+  {
+    out.emplace_back (std::get<1> (*l), r->first);
+  }
+
+  std::vector<std::pair<std::string, std::string>> out;
+};
+
+struct row_sink
+{
+  void operator() (event_iter l)
+  {
+    out.push_back (std::get<1> (*l));
+  }
+
+  void operator() (tag_iter r)
+  {
+    out.push_back (r->first);
+  }
+
+  std::vector<std::string> out;
+};
+
+struct counting_less
+{
+  bool operator() (long lhs, long rhs) const
+  {
+    ++*count;
+    return lhs < rhs;
+  }
+
+  std::shared_ptr<std::size_t> count;
+};
+
+int main()
+{
+  const std::vector<event> events {
+    { 1, "a" }, { 2, "b" }, { 2, "c" }, { 5, "d" }, { 9, "e" }, { 9, "f" }, { 12, "g" }
+  };
+
+  const std::vector<tag> tags {
+    { "x", 2 }, { "y", 2 }, { "z", 4 }, { "w", 9 }, { "v", 13 }
+  };
+
+  auto joined = merge_join<0, 1> (events, tags, pair_sink { }).out;
+  assert ((joined == std::vector<std::pair<std::string, std::string>> {
+    { "b", "x" }, { "b", "y" }, { "c", "x" }, { "c", "y" }, { "e", "w" }, { "f", "w" }
+  }));
+
+  auto semi = semi_join<0, 1> (events, tags, row_sink { }).out;
+  assert ((semi == std::vector<std::string> { "b", "c", "e", "f" }));
+
+  auto anti = anti_join<0, 1> (events, tags, row_sink { }).out;
+  assert ((anti == std::vector<std::string> { "a", "d", "g" }));
+
+  auto sym = symmetric_anti_join<0, 1> (events, tags, row_sink { }, row_sink { });
+  assert ((sym.first.out == std::vector<std::string> { "a", "d", "g" }));
+  assert ((sym.second.out == std::vector<std::string> { "z", "v" }));
+
+  // Sparse right side: galloping must not skip matches.
+  std::vector<std::tuple<long>> dense;
+  for (long i = 0; i < 10000; ++i)
+    dense.emplace_back (i / 2);
+  std::vector<std::tuple<long>> sparse { std::make_tuple (0L), std::make_tuple (777L),
+                                         std::make_tuple (4999L), std::make_tuple (6000L) };
+
+  std::size_t count = 0;
+  merge_join<0, 0> (dense.begin (), dense.end (), sparse.begin (), sparse.end (),
+                    [&count](std::vector<std::tuple<long>>::iterator l,
+                             std::vector<std::tuple<long>>::iterator r)
+                    {
+                      assert (std::get<0> (*l) == std::get<0> (*r));
+                      ++count;
+                    });
+  assert (count == 6);
+
+  count = 0;
+  merge_join<0, 0> (sparse.begin (), sparse.end (), dense.begin (), dense.end (),
+                    [&count](std::vector<std::tuple<long>>::iterator,
+                             std::vector<std::tuple<long>>::iterator) { ++count; });
+  assert (count == 6);
+
+  count = 0;
+  anti_join<0, 0> (dense, sparse, [&count](std::vector<std::tuple<long>>::iterator) { ++count; });
+  assert (count == 9994);
+
+  // Interleaved keys take no more comparisons than an ordinary merge, at most
+  // two per step, while a sparse side is skipped in logarithmic time.
+  std::vector<std::tuple<long>> evens;
+  std::vector<std::tuple<long>> odds;
+  for (long i = 0; i < 20000; ++i)
+    (i % 2 == 0 ? evens : odds).emplace_back (i);
+
+  counting_less comp { std::make_shared<std::size_t> (0) };
+  count = 0;
+  merge_join<0, 0> (evens, odds,
+                    [&count](std::vector<std::tuple<long>>::iterator,
+                             std::vector<std::tuple<long>>::iterator) { ++count; },
+                    comp);
+  assert (count == 0);
+  assert (*comp.count <= 2 * (evens.size () + odds.size ()));
+
+  *comp.count = 0;
+  count = 0;
+  merge_join<0, 0> (dense, sparse,
+                    [&count](std::vector<std::tuple<long>>::iterator,
+                             std::vector<std::tuple<long>>::iterator) { ++count; },
+                    comp);
+  assert (count == 6);
+  assert (*comp.count < 500);
+
+  // Non-random-access ranges step linearly.
+  std::list<event> levents (events.begin (), events.end ());
+  std::vector<std::string> lsemi;
+  semi_join<0, 1> (levents.cbegin (), levents.cend (), tags.begin (), tags.end (),
+                   [&lsemi](std::list<event>::const_iterator l)
+                   {
+                     lsemi.push_back (std::get<1> (*l));
+                   });
+  assert ((lsemi == std::vector<std::string> { "b", "c", "e", "f" }));
+
+  return 0;
+}